@@ -0,0 +1,177 @@
+/*
+ *
+ * Copyright 2013-2014 by MotionPortrait, Inc.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef MPASSETCACHE_H_
+#define MPASSETCACHE_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "mptypes.h"
+#include "mpreflru.h"
+#include "mpctlitem.h"
+#include "mpcosme.h"
+
+namespace motionportrait {
+
+
+/**
+ * \class MpAssetCache
+ *
+ * MpAssetCache keeps item/cosme data created from files, so that the
+ * same file is created only once while it is in use or cached.
+ * unused data are destroyed in LRU order while the total size of cached
+ * data, including data in use, exceeds the budget. data in use are never
+ * destroyed, so the total can exceed the budget while they are used.
+ *
+ * size of data is given to Acquire() by the caller. if it is not given,
+ * the file size is used, which is only a proxy: it is not GPU memory,
+ * and decoded textures can be many times larger than compressed files.
+ *
+ * Ctl must provide Id Create(const char*) and mpResult Destroy(Id).
+ * use MpItemCache or MpCosmeCache.
+ *
+ * note:
+ * all functions must be called from GL thread
+ */
+template <class Ctl, class Id>
+class MpAssetCache {
+
+  public:
+
+    /**
+     * Initialize
+     *
+     * @param ctl    : controller which creates/destroys data
+     * @param budget : byte budget of cached data, including data in use
+     */
+    mpResult Init(Ctl *ctl, size_t budget) {
+        if (ctl == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        Clear();
+        ctl_    = ctl;
+        budget_ = budget;
+        return MP_SUCCESS;
+    }
+
+    /**
+     * get data. created from file if not cached.
+     * Release() must be called when it is no longer used.
+     *
+     * @param path : path to data file
+     * @param size : size of data in byte, e.g. estimated texture bytes.
+     *               if 0, file size is used. ignored if already cached
+     * @return data id. NULL if failed
+     */
+    Id Acquire(const char *path, size_t size = 0) {
+        if (ctl_ == NULL || path == NULL) {
+            return (Id)NULL;
+        }
+        Id id = (Id)NULL;
+        if (lru_.Acquire(path, id)) {
+            return id;
+        }
+
+        id = ctl_->Create(path);
+        if (id == (Id)NULL) {
+            return (Id)NULL;
+        }
+        lru_.Insert(path, id, (size > 0) ? size : FileSize(path));
+        Evict();
+        return id;
+    }
+
+    /**
+     * release data acquired by Acquire()
+     *
+     * @param id : data id
+     */
+    mpResult Release(Id id) {
+        mpResult res = lru_.Release(id);
+        if (res == MP_SUCCESS) {
+            Evict();
+        }
+        return res;
+    }
+
+    /**
+     * change byte budget
+     *
+     * @param budget : byte budget
+     */
+    void SetBudget(size_t budget) {
+        budget_ = budget;
+        Evict();
+    }
+
+    /**
+     * get total size of cached data in byte, including data in use
+     */
+    size_t GetSize() const { return lru_.GetSize(); }
+
+    /**
+     * destroy all data.
+     * data still in use are also destroyed.
+     */
+    void Clear() {
+        std::vector<Id> ids;
+        lru_.Clear(ids);
+        for (size_t i = 0; i < ids.size(); i++) {
+            ctl_->Destroy(ids[i]);
+        }
+    }
+
+    /**
+     */
+    MpAssetCache() : ctl_(NULL), budget_(0) {}
+    virtual ~MpAssetCache() { Clear(); }
+
+  private:
+    void Evict() {
+        Id id;
+        while (lru_.GetSize() > budget_ && lru_.PopUnused(id)) {
+            ctl_->Destroy(id);
+        }
+    }
+
+    static size_t FileSize(const char *path) {
+        FILE *fp = fopen(path, "rb");
+        if (fp == NULL) {
+            return 0;
+        }
+        long size = (fseek(fp, 0, SEEK_END) == 0) ? ftell(fp) : 0;
+        fclose(fp);
+        return (size > 0) ? (size_t)size : 0;
+    }
+
+    Ctl         *ctl_;
+    size_t       budget_;
+    MpRefLru<Id> lru_;
+
+    // No copy
+    MpAssetCache(const MpAssetCache &src);
+    MpAssetCache& operator=(const MpAssetCache &src);
+};
+
+/**
+ * item data cache for a face. ids are valid only for the MpCtlItem, and
+ * only while its face is loaded. Clear() it before the face is unloaded,
+ * e.g. in the evict callback of MpFacePool.
+ */
+typedef MpAssetCache<MpCtlItem, MpCtlItem::ItemId> MpItemCache;
+
+/**
+ * cosme cache. ids can be set to any face by MpCosme::SetCosme().
+ */
+typedef MpAssetCache<MpCosme, MpCosme::CosmeId> MpCosmeCache;
+
+
+} // namespace motionportrait
+
+#endif /* MPASSETCACHE_H_ */
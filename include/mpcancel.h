@@ -0,0 +1,88 @@
+/*
+ *
+ * Copyright 2013-2014 by MotionPortrait, Inc.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef MPCANCEL_H_
+#define MPCANCEL_H_
+
+// requires C++11
+#include <atomic>
+#include <chrono>
+#include "mptypes.h"
+
+namespace motionportrait {
+
+
+/**
+ * \class MpCancelToken
+ *
+ * MpCancelToken tells helper APIs to stop at the next stage boundary.
+ * a token is cancelled by Cancel() or when its deadline has passed.
+ * cancelled APIs return MP_ERROR_TIMEOUT.
+ *
+ * Cancel() and IsCancelled() can be called from any thread.
+ * a call to the SDK which is already running is not interrupted.
+ */
+class MpCancelToken {
+
+  public:
+
+    /**
+     * cancel
+     */
+    void Cancel() { cancelled_.store(true); }
+
+    /**
+     * set deadline. call before passing the token to other threads.
+     *
+     * @param msec : milli second from now. negative value clears deadline
+     */
+    void SetDeadline(long msec) {
+        hasDeadline_ = (msec >= 0);
+        deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(msec);
+    }
+
+    /**
+     * check cancellation
+     *
+     * @return true if cancelled or deadline has passed
+     */
+    bool IsCancelled() const {
+        if (cancelled_.load()) {
+            return true;
+        }
+        return hasDeadline_ && std::chrono::steady_clock::now() >= deadline_;
+    }
+
+    /**
+     * check cancellation
+     *
+     * @return MP_ERROR_TIMEOUT if cancelled, otherwise MP_SUCCESS
+     */
+    mpResult Check() const {
+        return IsCancelled() ? MP_ERROR_TIMEOUT : MP_SUCCESS;
+    }
+
+    /**
+     */
+    MpCancelToken() : cancelled_(false), hasDeadline_(false) {}
+    virtual ~MpCancelToken() {}
+
+  private:
+    std::atomic<bool> cancelled_;
+    bool              hasDeadline_;
+    std::chrono::steady_clock::time_point deadline_;
+
+    // No copy
+    MpCancelToken(const MpCancelToken &src);
+    MpCancelToken& operator=(const MpCancelToken &src);
+};
+
+
+} // namespace motionportrait
+
+#endif /* MPCANCEL_H_ */
@@ -0,0 +1,164 @@
+/*
+ *
+ * Copyright 2013-2014 by MotionPortrait, Inc.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef MPFACEPOOL_H_
+#define MPFACEPOOL_H_
+
+#include <vector>
+#include "mptypes.h"
+#include "mpface.h"
+#include "mpreflru.h"
+
+namespace motionportrait {
+
+
+/**
+ * \class MpFacePool
+ *
+ * MpFacePool keeps faces loaded after they are released, so switching
+ * back to a recent face is only MpRender::SetFace() and no Load().
+ * unused faces are unloaded in LRU order when more than the capacity are
+ * kept, and their MpFace instances are reused for the next Load().
+ *
+ * unloading a face invalidates every id created on it, e.g. item ids of
+ * its MpCtlItem. data kept for a face outside the pool, such as an
+ * MpItemCache on its MpCtlItem, must be cleared in the evict callback.
+ *
+ * note:
+ * all functions must be called from GL thread.
+ * item/animation/speech state of a kept face is not reset.
+ */
+class MpFacePool {
+
+  public:
+
+    /**
+     * evict callback. called before a face is unloaded by Init(), Release()
+     * or Clear(), including faces still in use at Clear().
+     *
+     * @param face : face to be unloaded
+     * @param user : user data passed to Init()
+     */
+    typedef void (*EvictCallback)(MpFace *face, void *user);
+
+    /**
+     * Initialize
+     *
+     * @param capacity : max number of unused faces kept loaded
+     * @param cb       : evict callback. may be NULL
+     * @param user     : user data passed to cb
+     */
+    mpResult Init(int capacity, EvictCallback cb = NULL, void *user = NULL) {
+        if (capacity < 0) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        capacity_ = capacity;
+        evictCb_   = cb;
+        evictUser_ = user;
+        Evict();
+        return MP_SUCCESS;
+    }
+
+    /**
+     * get face loaded from file. loaded if not kept.
+     * Release() must be called when it is no longer used.
+     *
+     * @param pathFace : path to face file
+     * @param pFace    : [out]loaded face
+     */
+    mpResult Acquire(const char *pathFace, MpFace **pFace) {
+        if (pathFace == NULL || pFace == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        if (lru_.Acquire(pathFace, *pFace)) {
+            return MP_SUCCESS;
+        }
+
+        MpFace *face = NULL;
+        if (!free_.empty()) {
+            face = free_.back();
+            free_.pop_back();
+        } else {
+            face = new MpFace();
+        }
+        mpResult res = face->Load(pathFace);
+        if (res != MP_SUCCESS) {
+            free_.push_back(face);
+            return res;
+        }
+        lru_.Insert(pathFace, face, 1);
+        *pFace = face;
+        return MP_SUCCESS;
+    }
+
+    /**
+     * release face acquired by Acquire()
+     *
+     * @param face : face to be released
+     */
+    mpResult Release(MpFace *face) {
+        mpResult res = lru_.Release(face);
+        if (res == MP_SUCCESS) {
+            Evict();
+        }
+        return res;
+    }
+
+    /**
+     * unload and delete all faces.
+     * faces still in use are also deleted.
+     */
+    void Clear() {
+        std::vector<MpFace*> faces;
+        lru_.Clear(faces);
+        for (size_t i = 0; i < faces.size(); i++) {
+            Unload(faces[i]);
+            delete faces[i];
+        }
+        for (size_t i = 0; i < free_.size(); i++) {
+            delete free_[i];
+        }
+        free_.clear();
+    }
+
+    /**
+     */
+    MpFacePool() : capacity_(0), evictCb_(NULL), evictUser_(NULL) {}
+    virtual ~MpFacePool() { Clear(); }
+
+  private:
+    void Evict() {
+        MpFace *face = NULL;
+        while (lru_.GetUnusedCount() > (size_t)capacity_ && lru_.PopUnused(face)) {
+            Unload(face);
+            free_.push_back(face);
+        }
+    }
+
+    void Unload(MpFace *face) {
+        if (evictCb_ != NULL) {
+            evictCb_(face, evictUser_);
+        }
+        face->Unload();
+    }
+
+    int                   capacity_;
+    EvictCallback         evictCb_;
+    void                 *evictUser_;
+    MpRefLru<MpFace*>     lru_;
+    std::vector<MpFace*>  free_;
+
+    // No copy
+    MpFacePool(const MpFacePool &src);
+    MpFacePool& operator=(const MpFacePool &src);
+};
+
+
+} // namespace motionportrait
+
+#endif /* MPFACEPOOL_H_ */
@@ -0,0 +1,121 @@
+/*
+ *
+ * Copyright 2013-2014 by MotionPortrait, Inc.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef MPLAZYINIT_H_
+#define MPLAZYINIT_H_
+
+// requires C++11
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "mptypes.h"
+
+namespace motionportrait {
+
+
+/**
+ * \class MpLazyInit
+ *
+ * MpLazyInit defers Init() of MpSynth or MpaAnalyzer until the instance
+ * is first used, so that processes which never use it do not pay for
+ * loading its resources.
+ *
+ * T must provide Init(const char *pathRes). e.g.
+ *   MpLazyInit<MpSynth>     synth("res/synth");
+ *   MpLazyInit<MpaAnalyzer> analyzer("res/analyzer");
+ *   analyzer.Warmup();                     // optional, in background
+ *   ...
+ *   MpSynth *s = synth.Get();              // Init() runs here
+ */
+template <class T>
+class MpLazyInit {
+
+  public:
+
+    /**
+     * @param pathRes : path to resource directory passed to T::Init()
+     */
+    explicit MpLazyInit(const char *pathRes)
+    : pathRes_(pathRes ? pathRes : ""), done_(false), result_(MP_SUCCESS), initTime_(0) {}
+
+    virtual ~MpLazyInit() {
+        if (warmup_.joinable()) {
+            warmup_.join();
+        }
+    }
+
+    /**
+     * get instance. Init() is called at the first call.
+     * thread safe. if Warmup() is running, waits for it.
+     *
+     * @return instance. NULL if Init() failed
+     */
+    T* Get() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!done_) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            result_ = obj_.Init(pathRes_.c_str());
+            initTime_ = (long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() - start).count();
+            done_ = true;
+        }
+        return (result_ == MP_SUCCESS) ? &obj_ : NULL;
+    }
+
+    /**
+     * start Init() in background thread.
+     * has no effect if already initialized or started.
+     */
+    mpResult Warmup() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (done_ || warmup_.joinable()) {
+            return MP_SUCCESS;
+        }
+        warmup_ = std::thread([this]() { Get(); });
+        return MP_SUCCESS;
+    }
+
+    /**
+     * get result of Init()
+     *
+     * @return result of Init(). MP_ERROR_INVALID_STATE if not initialized yet
+     */
+    mpResult GetInitResult() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return done_ ? result_ : MP_ERROR_INVALID_STATE;
+    }
+
+    /**
+     * get time spent by Init()
+     *
+     * @return milli second. 0 if not initialized yet
+     */
+    long GetInitTime() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return initTime_;
+    }
+
+  private:
+    T           obj_;
+    std::string pathRes_;
+    std::mutex  mutex_;
+    std::thread warmup_;
+    bool        done_;
+    mpResult    result_;
+    long        initTime_;
+
+    // No copy
+    MpLazyInit(const MpLazyInit &src);
+    MpLazyInit& operator=(const MpLazyInit &src);
+};
+
+
+} // namespace motionportrait
+
+#endif /* MPLAZYINIT_H_ */
@@ -0,0 +1,316 @@
+/*
+ *
+ * Copyright 2013-2014 by MotionPortrait, Inc.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef MPLODRENDER_H_
+#define MPLODRENDER_H_
+
+#include <string>
+#include "mptypes.h"
+#include "mprender.h"
+
+namespace motionportrait {
+
+
+class MpFace;
+
+/**
+ * \class MpLodRender
+ *
+ * MpLodRender draws avatars with face mesh division selected by the
+ * on-screen viewport size, so that small avatars (e.g. thumbnails in a
+ * grid) are drawn with a coarse mesh.
+ *
+ * each level owns an MpRender initialized with its own faceMeshDiv.
+ * faces can be switched by SetFace/SetViewport/Draw as with MpRender.
+ *
+ * note:
+ * all functions must be called from GL thread
+ */
+class MpLodRender {
+
+  public:
+
+    /** maximum number of levels */
+    static const int LOD_MAX = 4;
+
+    /**
+     * add level. levels must be added from the finest one.
+     *
+     * @param faceMeshDiv : number of division of face mesh
+     * @param minSize     : minimum viewport size (max of width and height)
+     *                      to use this level. ignored for the last level
+     * @param controlFlag : bit flag by MpRender::FLAG_XXX
+     */
+    mpResult AddLevel(int faceMeshDiv, int minSize, int controlFlag = 0) {
+        if (nLod_ >= LOD_MAX || faceMeshDiv <= 0) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        if (nLod_ > 0 && minSize > lod_[nLod_ - 1].minSize) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        Level &l = lod_[nLod_];
+        l.render = new MpRender();
+#ifdef WEBGL
+        mpResult res = l.render->InitWithParam(faceMeshDiv, controlFlag);
+#else
+        MpRender::Context ctxt;
+        ctxt.faceMeshDiv = faceMeshDiv;
+        ctxt.controlFlag = controlFlag;
+        mpResult res = l.render->Init(&ctxt);
+#endif
+        if (res == MP_SUCCESS) {
+            res = ApplySettings(l.render);
+        }
+        if (res != MP_SUCCESS) {
+            delete l.render;
+            l.render = NULL;
+            return res;
+        }
+        l.minSize = minSize;
+        l.face    = NULL;
+        nLod_++;
+        return MP_SUCCESS;
+    }
+
+    /**
+     * set commonparts to all levels, including levels added later
+     *
+     * @param commonPartsDir : same as MpRender::SetResourcePath()
+     */
+    mpResult SetResourcePath(const char *commonPartsDir) {
+        hasResPath_  = true;
+        resPathNull_ = (commonPartsDir == NULL);
+        resPath_     = commonPartsDir ? commonPartsDir : "";
+        for (int i = 0; i < nLod_; i++) {
+            mpResult res = lod_[i].render->SetResourcePath(commonPartsDir);
+            if (res != MP_SUCCESS) {
+                return res;
+            }
+        }
+        return MP_SUCCESS;
+    }
+
+    /**
+     * @name MpRender settings
+     * same as MpRender. applied to all levels, including levels added later,
+     * so that they do not change when the selected level changes.
+     * @{
+     */
+    mpResult SetRotateZ(float rotateZ) {
+        hasRotateZ_ = true;
+        rotateZ_    = rotateZ;
+        for (int i = 0; i < nLod_; i++) {
+            mpResult res = lod_[i].render->SetRotateZ(rotateZ);
+            if (res != MP_SUCCESS) {
+                return res;
+            }
+        }
+        return MP_SUCCESS;
+    }
+
+    mpResult EnableDrawBackground(bool enable) {
+        hasBackground_ = true;
+        background_    = enable;
+        for (int i = 0; i < nLod_; i++) {
+            mpResult res = lod_[i].render->EnableDrawBackground(enable);
+            if (res != MP_SUCCESS) {
+                return res;
+            }
+        }
+        return MP_SUCCESS;
+    }
+
+    mpResult SetDepthTestMode(bool enable) {
+        hasDepthTest_ = true;
+        depthTest_    = enable;
+        for (int i = 0; i < nLod_; i++) {
+            mpResult res = lod_[i].render->SetDepthTestMode(enable);
+            if (res != MP_SUCCESS) {
+                return res;
+            }
+        }
+        return MP_SUCCESS;
+    }
+
+    int EnableCustomOrtho(bool enable) {
+        hasOrthoEnable_ = true;
+        orthoEnable_    = enable;
+        for (int i = 0; i < nLod_; i++) {
+            int res = lod_[i].render->EnableCustomOrtho(enable);
+            if (res != MP_SUCCESS) {
+                return res;
+            }
+        }
+        return MP_SUCCESS;
+    }
+
+    int SetCustomOrtho(float left, float right, float bottom, float top, float znear, float zfar) {
+        hasOrtho_ = true;
+        ortho_[0] = left;
+        ortho_[1] = right;
+        ortho_[2] = bottom;
+        ortho_[3] = top;
+        ortho_[4] = znear;
+        ortho_[5] = zfar;
+        for (int i = 0; i < nLod_; i++) {
+            int res = lod_[i].render->SetCustomOrtho(left, right, bottom, top, znear, zfar);
+            if (res != MP_SUCCESS) {
+                return res;
+            }
+        }
+        return MP_SUCCESS;
+    }
+    /** @} */
+
+    /**
+     * set face
+     *
+     * @param face : MpFace instance to be rendered
+     */
+    mpResult SetFace(MpFace *face) {
+        face_ = face;
+        for (int i = 0; i < nLod_; i++) {
+            lod_[i].face = NULL;
+        }
+        return MP_SUCCESS;
+    }
+
+    /**
+     * set viewport and select level
+     *
+     * @param viewport : viewport information
+     */
+    mpResult SetViewport(mpRect &viewport) {
+        if (nLod_ == 0) {
+            return MP_ERROR_INVALID_STATE;
+        }
+        int size = (viewport.width > viewport.height) ? viewport.width : viewport.height;
+        cur_ = nLod_ - 1;
+        for (int i = 0; i < nLod_ - 1; i++) {
+            if (size >= lod_[i].minSize) {
+                cur_ = i;
+                break;
+            }
+        }
+        return lod_[cur_].render->SetViewport(viewport);
+    }
+
+    /**
+     * get level selected by SetViewport()
+     *
+     * @return level index. 0 is the finest
+     */
+    int GetLevel() const { return cur_; }
+
+    /**
+     * get MpRender of level.
+     * settings made through it apply to that level only. use the
+     * settings API of MpLodRender for settings shared by all levels.
+     *
+     * @param level : level index
+     */
+    MpRender* GetRender(int level) {
+        return (level >= 0 && level < nLod_) ? lod_[level].render : NULL;
+    }
+
+    /**
+     * draw avatar with the selected level
+     */
+    mpResult Draw() {
+        if (nLod_ == 0 || face_ == NULL) {
+            return MP_ERROR_INVALID_STATE;
+        }
+        Level &l = lod_[cur_];
+        if (l.face != face_) {
+            mpResult res = l.render->SetFace(face_);
+            if (res != MP_SUCCESS) {
+                return res;
+            }
+            l.face = face_;
+        }
+        return l.render->Draw();
+    }
+
+    /**
+     */
+    MpLodRender()
+    : nLod_(0), cur_(0), face_(NULL), hasResPath_(false), resPathNull_(false),
+      hasRotateZ_(false), rotateZ_(0.0f), hasBackground_(false), background_(false),
+      hasDepthTest_(false), depthTest_(false), hasOrthoEnable_(false), orthoEnable_(false),
+      hasOrtho_(false) {
+        for (int i = 0; i < LOD_MAX; i++) {
+            lod_[i].render  = NULL;
+            lod_[i].minSize = 0;
+            lod_[i].face    = NULL;
+        }
+    }
+    virtual ~MpLodRender() {
+        for (int i = 0; i < nLod_; i++) {
+            delete lod_[i].render;
+        }
+    }
+
+  private:
+    // apply settings made so far to a newly added level
+    mpResult ApplySettings(MpRender *r) {
+        mpResult res = MP_SUCCESS;
+        if (hasResPath_) {
+            res = r->SetResourcePath(resPathNull_ ? NULL : resPath_.c_str());
+        }
+        if (res == MP_SUCCESS && hasRotateZ_) {
+            res = r->SetRotateZ(rotateZ_);
+        }
+        if (res == MP_SUCCESS && hasBackground_) {
+            res = r->EnableDrawBackground(background_);
+        }
+        if (res == MP_SUCCESS && hasDepthTest_) {
+            res = r->SetDepthTestMode(depthTest_);
+        }
+        if (res == MP_SUCCESS && hasOrtho_) {
+            res = r->SetCustomOrtho(ortho_[0], ortho_[1], ortho_[2], ortho_[3], ortho_[4], ortho_[5]);
+        }
+        if (res == MP_SUCCESS && hasOrthoEnable_) {
+            res = r->EnableCustomOrtho(orthoEnable_);
+        }
+        return res;
+    }
+
+    struct Level {
+        MpRender *render;
+        int       minSize;
+        MpFace   *face;
+    };
+
+    Level   lod_[LOD_MAX];
+    int     nLod_;
+    int     cur_;
+    MpFace *face_;
+
+    bool        hasResPath_;
+    bool        resPathNull_;
+    std::string resPath_;
+    bool    hasRotateZ_;
+    float   rotateZ_;
+    bool    hasBackground_;
+    bool    background_;
+    bool    hasDepthTest_;
+    bool    depthTest_;
+    bool    hasOrthoEnable_;
+    bool    orthoEnable_;
+    bool    hasOrtho_;
+    float   ortho_[6];
+
+    // No copy
+    MpLodRender(const MpLodRender &src);
+    MpLodRender& operator=(const MpLodRender &src);
+};
+
+
+} // namespace motionportrait
+
+#endif /* MPLODRENDER_H_ */
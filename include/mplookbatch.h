@@ -0,0 +1,419 @@
+/*
+ *
+ * Copyright 2013-2014 by MotionPortrait, Inc.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef MPLOOKBATCH_H_
+#define MPLOOKBATCH_H_
+
+// requires C++11
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "mptypes.h"
+#include "mpctlitem.h"
+#include "mpcosme.h"
+
+namespace motionportrait {
+
+
+class MpFace;
+
+/**
+ * \class MpLookBatch
+ *
+ * MpLookBatch records item/cosme changes from any thread and applies
+ * them on GL thread at once.
+ *
+ * Begin() locks the batch for the calling thread until Commit() or
+ * Rollback(), which must be called from the same thread. recording
+ * functions must be called only by that thread between them; they do not
+ * check it, and calling them without Begin() is a data race.
+ *
+ * changes recorded between Begin() and Commit() are applied together by
+ * the next Apply(), so a draw never sees only some of them. Apply() does
+ * not roll back: if an SDK call fails, the others are still applied and
+ * the look may be partial. unsets are applied first, then sets, then
+ * parameters, so an item can be swapped for another in one batch.
+ * repeated changes of the same
+ * parameter are coalesced and only the last value is applied, e.g.
+ * ChangeTexture() called many times uploads only the last image.
+ *
+ * usage:
+ *   // any thread
+ *   batch.Begin();
+ *   batch.SetColor(ctl, id, r, g, b);
+ *   batch.SetCosme(cosme, face, cosmeId, &color);
+ *   batch.Commit();
+ *
+ *   // GL thread, before MpRender::Draw()
+ *   batch.Apply();
+ */
+class MpLookBatch {
+
+  public:
+
+    /**
+     * begin recording. blocks while another thread is recording.
+     */
+    void Begin() {
+        recMutex_.lock();
+        pending_ = Changes();
+    }
+
+    /**
+     * end recording. recorded changes are applied by the next Apply().
+     * must be called from the thread which called Begin()
+     */
+    void Commit() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Merge(committed_, pending_);
+        }
+        pending_ = Changes();
+        recMutex_.unlock();
+    }
+
+    /**
+     * end recording and discard recorded changes.
+     * must be called from the thread which called Begin()
+     */
+    void Rollback() {
+        pending_ = Changes();
+        recMutex_.unlock();
+    }
+
+    /**
+     * @name recording API
+     * same as MpCtlItem/MpCosme. must be called between Begin() and Commit()
+     * on the thread which called Begin()
+     * @{
+     */
+    mpResult SetItem(MpCtlItem *ctl, MpCtlItem::ItemId id, int depth = 0) {
+        if (ctl == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        ItemState &s = pending_.items[ItemKey(ctl, id)];
+        s.bind  = BIND_SET;
+        s.depth = depth;
+        return MP_SUCCESS;
+    }
+
+    mpResult UnsetItem(MpCtlItem *ctl, MpCtlItem::ItemId id) {
+        if (ctl == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        pending_.items[ItemKey(ctl, id)].bind = BIND_UNSET;
+        return MP_SUCCESS;
+    }
+
+    mpResult Adjust(MpCtlItem *ctl, MpCtlItem::ItemId id, const MpCtlItem::AdjustParam &adjust) {
+        if (ctl == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        ItemState &s = pending_.items[ItemKey(ctl, id)];
+        s.hasAdjust = true;
+        s.adjust    = adjust;
+        return MP_SUCCESS;
+    }
+
+    mpResult SetColor(MpCtlItem *ctl, MpCtlItem::ItemId id, float red, float green, float blue) {
+        if (ctl == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        ItemState &s = pending_.items[ItemKey(ctl, id)];
+        s.hasColor = true;
+        s.color[0] = red;
+        s.color[1] = green;
+        s.color[2] = blue;
+        return MP_SUCCESS;
+    }
+
+    mpResult SetAlpha(MpCtlItem *ctl, MpCtlItem::ItemId id, float alpha) {
+        if (ctl == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        ItemState &s = pending_.items[ItemKey(ctl, id)];
+        s.hasAlpha = true;
+        s.alpha    = alpha;
+        return MP_SUCCESS;
+    }
+
+    /** rgba (w*h RGBA pixels) is copied */
+    mpResult ChangeTexture(MpCtlItem *ctl, MpCtlItem::ItemId id, int w, int h, const void *rgba) {
+        if (ctl == NULL || rgba == NULL || w <= 0 || h <= 0) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        ItemState &s = pending_.items[ItemKey(ctl, id)];
+        const unsigned char *p = static_cast<const unsigned char *>(rgba);
+        s.hasTex = true;
+        s.texW   = w;
+        s.texH   = h;
+        s.tex.assign(p, p + (size_t)w * (size_t)h * 4);
+        return MP_SUCCESS;
+    }
+
+    mpResult AdjustGlasses(MpCtlItem *ctl, MpCtlItem::ItemId id, const MpCtlItem::AdjustGlassesParam &adjust) {
+        if (ctl == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        ItemState &s = pending_.items[ItemKey(ctl, id)];
+        s.hasGlasses = true;
+        s.glasses    = adjust;
+        return MP_SUCCESS;
+    }
+
+    mpResult SetGlassesLensColor(MpCtlItem *ctl, MpCtlItem::ItemId id, const mpColor &col) {
+        if (ctl == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        ItemState &s = pending_.items[ItemKey(ctl, id)];
+        s.hasLens = true;
+        s.lens    = col;
+        return MP_SUCCESS;
+    }
+
+    /** setting the same cosme again only changes its color */
+    mpResult SetCosme(MpCosme *cosme, MpFace *face, MpCosme::CosmeId id, const mpColor *color = NULL,
+                MpCosme::SkinColorType skinColorType = MpCosme::SKIN_COLOR_TYPE_DEFAULT) {
+        if (cosme == NULL || face == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        CosmeOp op;
+        op.id       = id;
+        op.hasColor = (color != NULL);
+        if (color != NULL) {
+            op.color = *color;
+        }
+        op.skin     = skinColorType;
+        AddCosme(pending_.cosmes[CosmeKey(cosme, face)], op);
+        return MP_SUCCESS;
+    }
+
+    mpResult UnsetCosme(MpCosme *cosme, MpFace *face) {
+        if (cosme == NULL || face == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        FaceCosme &fc = pending_.cosmes[CosmeKey(cosme, face)];
+        fc.unset = true;
+        fc.sets.clear();
+        return MP_SUCCESS;
+    }
+    /** @} */
+
+    /**
+     * apply committed changes.
+     * must be called from GL thread
+     *
+     * @return first error. other changes are still applied if one fails
+     */
+    mpResult Apply() {
+        Changes changes;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::swap(changes, committed_);
+        }
+
+        mpResult res = MP_SUCCESS;
+
+        // unset first, so that a new item/cosme replaces the old one
+        for (ItemMap::iterator it = changes.items.begin(); it != changes.items.end(); ++it) {
+            if (it->second.bind == BIND_UNSET) {
+                Keep(res, it->first.first->UnsetItem(it->first.second));
+            }
+        }
+        for (CosmeMap::iterator it = changes.cosmes.begin(); it != changes.cosmes.end(); ++it) {
+            if (it->second.unset) {
+                Keep(res, it->first.first->UnsetCosme(*it->first.second));
+            }
+        }
+
+        for (ItemMap::iterator it = changes.items.begin(); it != changes.items.end(); ++it) {
+            if (it->second.bind == BIND_SET) {
+                Keep(res, it->first.first->SetItem(it->first.second, it->second.depth));
+            }
+        }
+        for (CosmeMap::iterator it = changes.cosmes.begin(); it != changes.cosmes.end(); ++it) {
+            MpCosme *cosme = it->first.first;
+            MpFace  &face  = *it->first.second;
+            FaceCosme &fc = it->second;
+            for (size_t i = 0; i < fc.sets.size(); i++) {
+                CosmeOp &op = fc.sets[i];
+#ifdef WEBGL
+                Keep(res, cosme->SetCosme(face, op.id, op.color));
+#else
+                Keep(res, cosme->SetCosme(face, op.id, op.hasColor ? &op.color : NULL, op.skin));
+#endif
+            }
+        }
+
+        for (ItemMap::iterator it = changes.items.begin(); it != changes.items.end(); ++it) {
+            MpCtlItem *ctl = it->first.first;
+            MpCtlItem::ItemId id = it->first.second;
+            ItemState &s = it->second;
+            if (s.hasAdjust) {
+                Keep(res, ctl->Adjust(id, s.adjust));
+            }
+            if (s.hasColor) {
+                Keep(res, ctl->SetColor(id, s.color[0], s.color[1], s.color[2]));
+            }
+            if (s.hasAlpha) {
+                Keep(res, ctl->SetAlpha(id, s.alpha));
+            }
+            if (s.hasTex) {
+                Keep(res, ctl->ChangeTexture(id, s.texW, s.texH, s.tex.empty() ? NULL : &s.tex[0]));
+            }
+            if (s.hasGlasses) {
+                Keep(res, ctl->AdjustGlasses(id, s.glasses));
+            }
+            if (s.hasLens) {
+                Keep(res, ctl->SetGlassesLensColor(id, s.lens));
+            }
+        }
+        return res;
+    }
+
+    /**
+     */
+    MpLookBatch() {}
+    virtual ~MpLookBatch() {}
+
+  private:
+    enum Bind {
+        BIND_NONE,
+        BIND_SET,
+        BIND_UNSET,
+    };
+
+    struct ItemState {
+        ItemState()
+        : bind(BIND_NONE), depth(0), hasAdjust(false), hasColor(false), hasAlpha(false), alpha(1.0f),
+          hasTex(false), texW(0), texH(0), hasGlasses(false), hasLens(false) {}
+        Bind  bind;
+        int   depth;
+        bool  hasAdjust;
+        MpCtlItem::AdjustParam adjust;
+        bool  hasColor;
+        float color[3];
+        bool  hasAlpha;
+        float alpha;
+        bool  hasTex;
+        int   texW;
+        int   texH;
+        std::vector<unsigned char> tex;
+        bool  hasGlasses;
+        MpCtlItem::AdjustGlassesParam glasses;
+        bool  hasLens;
+        mpColor lens;
+    };
+
+    struct CosmeOp {
+        CosmeOp() : id(0), hasColor(false), skin(MpCosme::SKIN_COLOR_TYPE_DEFAULT) {
+            color.r = color.g = color.b = color.a = 0.0f;
+        }
+        MpCosme::CosmeId id;
+        bool    hasColor;
+        mpColor color;
+        MpCosme::SkinColorType skin;
+    };
+
+    struct FaceCosme {
+        FaceCosme() : unset(false) {}
+        bool unset;
+        std::vector<CosmeOp> sets;
+    };
+
+    typedef std::pair<MpCtlItem*, MpCtlItem::ItemId> ItemKey;
+    typedef std::pair<MpCosme*, MpFace*>             CosmeKey;
+    typedef std::map<ItemKey, ItemState>             ItemMap;
+    typedef std::map<CosmeKey, FaceCosme>            CosmeMap;
+
+    struct Changes {
+        ItemMap  items;
+        CosmeMap cosmes;
+    };
+
+    static void Keep(mpResult &res, mpResult r) {
+        if (res == MP_SUCCESS) {
+            res = r;
+        }
+    }
+
+    static void AddCosme(FaceCosme &fc, const CosmeOp &op) {
+        for (size_t i = 0; i < fc.sets.size(); i++) {
+            if (fc.sets[i].id == op.id) {
+                fc.sets[i] = op;
+                return;
+            }
+        }
+        fc.sets.push_back(op);
+    }
+
+    static void Merge(Changes &dst, Changes &src) {
+        for (ItemMap::iterator it = src.items.begin(); it != src.items.end(); ++it) {
+            ItemState &d = dst.items[it->first];
+            ItemState &s = it->second;
+            if (s.bind != BIND_NONE) {
+                d.bind  = s.bind;
+                d.depth = s.depth;
+            }
+            if (s.hasAdjust) {
+                d.hasAdjust = true;
+                d.adjust    = s.adjust;
+            }
+            if (s.hasColor) {
+                d.hasColor = true;
+                d.color[0] = s.color[0];
+                d.color[1] = s.color[1];
+                d.color[2] = s.color[2];
+            }
+            if (s.hasAlpha) {
+                d.hasAlpha = true;
+                d.alpha    = s.alpha;
+            }
+            if (s.hasTex) {
+                d.hasTex = true;
+                d.texW   = s.texW;
+                d.texH   = s.texH;
+                d.tex.swap(s.tex);
+            }
+            if (s.hasGlasses) {
+                d.hasGlasses = true;
+                d.glasses    = s.glasses;
+            }
+            if (s.hasLens) {
+                d.hasLens = true;
+                d.lens    = s.lens;
+            }
+        }
+        for (CosmeMap::iterator it = src.cosmes.begin(); it != src.cosmes.end(); ++it) {
+            FaceCosme &d = dst.cosmes[it->first];
+            FaceCosme &s = it->second;
+            if (s.unset) {
+                d.unset = true;
+                d.sets.clear();
+            }
+            for (size_t i = 0; i < s.sets.size(); i++) {
+                AddCosme(d, s.sets[i]);
+            }
+        }
+    }
+
+    std::mutex recMutex_;
+    std::mutex mutex_;
+    Changes    pending_;
+    Changes    committed_;
+
+    // No copy
+    MpLookBatch(const MpLookBatch &src);
+    MpLookBatch& operator=(const MpLookBatch &src);
+};
+
+
+} // namespace motionportrait
+
+#endif /* MPLOOKBATCH_H_ */
@@ -0,0 +1,131 @@
+/*
+ *
+ * Copyright 2013-2014 by MotionPortrait, Inc.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef MPMKOCACHE_H_
+#define MPMKOCACHE_H_
+
+// requires C++11
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include "mptypes.h"
+#include "mpsynth.h"
+
+namespace motionportrait {
+
+
+/**
+ * \class MpMkoCache
+ *
+ * MpMkoCache loads each makeover template file once by MpSynth::Load()
+ * and shares the mko object between MkOvrSynth() calls.
+ *
+ * Get() and MkOvrSynth() can be called from several threads. when
+ * several threads request the same file at once, it is loaded by one of
+ * them and the others wait for it. MpSynth::Load() is not known to be
+ * reentrant, so loads of different files are serialized by a loader lock.
+ *
+ * each thread must use its own MpSynth instance. one mko object is passed
+ * to MkOvrSynth() of several threads at once; this assumes MkOvrSynth()
+ * only reads its mko input. if it does not, calls for the same template
+ * must be serialized by the caller.
+ *
+ * note:
+ * there is no API to free an mko object, so loaded objects are kept
+ * for the lifetime of the process.
+ */
+class MpMkoCache {
+
+  public:
+
+    /**
+     * get mko object of template file. loaded if not cached.
+     * failed loads are not cached.
+     *
+     * @param templateFile : path to template file
+     * @param pObject      : [out]mko object
+     */
+    mpResult Get(const char *templateFile, mpMkoObject *pObject) {
+        if (templateFile == NULL || pObject == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        EntryMap::iterator it = entries_.find(templateFile);
+        if (it != entries_.end()) {
+            std::shared_future<Entry> f = it->second;
+            lock.unlock();
+            Entry e = f.get();
+            *pObject = e.object;
+            return e.result;
+        }
+
+        std::promise<Entry> loading;
+        entries_[templateFile] = loading.get_future().share();
+        lock.unlock();
+
+        Entry e;
+        e.object = NULL;
+        {
+            std::lock_guard<std::mutex> loadLock(loadMutex_);
+            e.result = MpSynth::Load(templateFile, &e.object);
+        }
+        if (e.result != MP_SUCCESS) {
+            lock.lock();
+            entries_.erase(templateFile);
+            lock.unlock();
+        }
+        loading.set_value(e);
+        *pObject = e.object;
+        return e.result;
+    }
+
+    /**
+     * makeover to an avatar with cached template
+     * Output format should be FORMAT_BIN
+     *
+     * @param synth        : synthesizer
+     * @param inImg        : input image
+     * @param templateFile : path to template file for MakeOver
+     * @param pObject      : [out]generated face object. This object should be removed by DestroyFaceBin() when it is no longer used.
+     */
+    mpResult MkOvrSynth(MpSynth &synth, MpSynth::Img &inImg,
+                const char *templateFile, mpFaceObject *pObject) {
+        mpMkoObject mko = NULL;
+        mpResult res = Get(templateFile, &mko);
+        if (res != MP_SUCCESS) {
+            return res;
+        }
+        return synth.MkOvrSynth(inImg, mko, pObject);
+    }
+
+    /**
+     */
+    MpMkoCache() {}
+    virtual ~MpMkoCache() {}
+
+  private:
+    struct Entry {
+        mpMkoObject object;
+        mpResult    result;
+    };
+    typedef std::map<std::string, std::shared_future<Entry> > EntryMap;
+
+    std::mutex mutex_;
+    std::mutex loadMutex_;  // serializes MpSynth::Load()
+    EntryMap   entries_;
+
+    // No copy
+    MpMkoCache(const MpMkoCache &src);
+    MpMkoCache& operator=(const MpMkoCache &src);
+};
+
+
+} // namespace motionportrait
+
+#endif /* MPMKOCACHE_H_ */
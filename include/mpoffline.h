@@ -0,0 +1,344 @@
+/*
+ *
+ * Copyright 2013-2014 by MotionPortrait, Inc.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef MPOFFLINE_H_
+#define MPOFFLINE_H_
+
+#include <stdio.h>
+#include "mptypes.h"
+#include "mpface.h"
+#include "mprender.h"
+#include "mpctlanimation.h"
+#include "mpctlspeech.h"
+
+namespace motionportrait {
+
+
+/**
+ * \class MpOfflineRender
+ *
+ * MpOfflineRender steps an avatar with a fixed frame clock and draws
+ * every frame, for rendering to video faster than realtime.
+ *
+ * note:
+ * all functions must be called from GL thread.
+ * the GL context (and offscreen framebuffer) is owned by the caller,
+ * and pixels are read back by the caller in the frame callback.
+ */
+class MpOfflineRender {
+
+  public:
+
+    /**
+     * frame callback. called after each frame is drawn.
+     *
+     * @param frame : frame index
+     * @param msec  : frame time in milli second
+     * @param user  : user data passed to Run()
+     * @return MP_SUCCESS to continue, otherwise Run() stops and returns it
+     */
+    typedef mpResult (*FrameCallback)(int frame, long msec, void *user);
+
+    /**
+     * Initialize
+     *
+     * @param render    : renderer. SetFace/SetViewport must be done
+     * @param face      : face to be animated
+     * @param fps       : frames per second of the output
+     * @param startTime : time of frame 0 in milli second
+     */
+    mpResult Init(MpRender *render, MpFace *face, int fps, long startTime = 0) {
+        if (render == NULL || face == NULL || fps <= 0) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        render_    = render;
+        face_      = face;
+        fps_       = fps;
+        startTime_ = startTime;
+        frame_     = 0;
+        voice_     = NULL;
+        anim_      = NULL;
+        return MP_SUCCESS;
+    }
+
+    /**
+     * get frame time.
+     * computed from frame index, so it does not drift over long videos.
+     *
+     * @param frame : frame index
+     * @return frame time in milli second
+     */
+    long GetFrameTime(int frame) const {
+        return startTime_ + (long)((long long)frame * 1000 / fps_);
+    }
+
+    /**
+     * get index of the next frame to be drawn
+     */
+    int GetFrame() const { return frame_; }
+
+    /**
+     * start lip sync at the next frame.
+     * lip sync position is seeked to the frame clock every frame,
+     * so it does not depend on wall clock.
+     *
+     * @param voice : voice data id
+     */
+    mpResult Speak(MpCtlSpeech::VoiceId voice) {
+        if (face_ == NULL) {
+            return MP_ERROR_INVALID_STATE;
+        }
+        MpCtlSpeech *speech = face_->GetCtlSpeech();
+        mpResult res = speech->Speak(voice);
+        if (res != MP_SUCCESS) {
+            return res;
+        }
+        voice_     = voice;
+        voiceTime_ = GetFrameTime(frame_);
+        voiceLen_  = (long)speech->GetDuration(voice);
+        return MP_SUCCESS;
+    }
+
+    /**
+     * play animation data from the next frame until it finishes
+     *
+     * @param dataId      : animation data id
+     * @param blendEnable : enable unconscious animation blending
+     */
+    mpResult Animate(MpCtlAnimation::AnimDataId dataId, bool blendEnable = true) {
+        if (face_ == NULL) {
+            return MP_ERROR_INVALID_STATE;
+        }
+        anim_      = dataId;
+        animTime_  = GetFrameTime(frame_);
+        animBlend_ = blendEnable;
+        return MP_SUCCESS;
+    }
+
+    /**
+     * advance animation to the next frame time and draw it
+     */
+    mpResult Step() {
+        if (render_ == NULL) {
+            return MP_ERROR_INVALID_STATE;
+        }
+        long t = GetFrameTime(frame_);
+
+        if (voice_ != NULL) {
+            MpCtlSpeech *speech = face_->GetCtlSpeech();
+            long pos = t - voiceTime_;
+            mpResult res;
+            if (pos < voiceLen_) {
+                res = speech->SpeakSeek((int)pos);
+            } else {
+                // stop here, or lip sync keeps running on wall clock
+                voice_ = NULL;
+                res = speech->SpeakStop();
+            }
+            if (res != MP_SUCCESS) {
+                voice_ = NULL;
+                return res;
+            }
+        }
+
+        MpCtlAnimation *ctl = face_->GetCtlAnimation();
+        if (anim_ != NULL) {
+            if (ctl->AnimateData(animTime_, t, anim_, animBlend_) == 0) {
+                anim_ = NULL;
+            }
+        }
+        mpResult res = ctl->Update(t);
+        if (res != MP_SUCCESS) {
+            return res;
+        }
+        res = render_->Draw();
+        if (res != MP_SUCCESS) {
+            return res;
+        }
+        frame_++;
+        return MP_SUCCESS;
+    }
+
+    /**
+     * draw frames
+     *
+     * @param nFrame : number of frames to draw
+     * @param cb     : frame callback. may be NULL
+     * @param user   : user data passed to cb
+     */
+    mpResult Run(int nFrame, FrameCallback cb, void *user) {
+        for (int i = 0; i < nFrame; i++) {
+            int  frame = frame_;
+            mpResult res = Step();
+            if (res != MP_SUCCESS) {
+                return res;
+            }
+            if (cb != NULL) {
+                res = cb(frame, GetFrameTime(frame), user);
+                if (res != MP_SUCCESS) {
+                    return res;
+                }
+            }
+        }
+        return MP_SUCCESS;
+    }
+
+    /**
+     */
+    MpOfflineRender()
+    : render_(NULL), face_(NULL), fps_(30), startTime_(0), frame_(0),
+      voice_(NULL), voiceTime_(0), voiceLen_(0),
+      anim_(NULL), animTime_(0), animBlend_(true) {}
+    virtual ~MpOfflineRender() {}
+
+  private:
+    MpRender *render_;
+    MpFace   *face_;
+    int       fps_;
+    long      startTime_;
+    int       frame_;
+
+    MpCtlSpeech::VoiceId voice_;
+    long      voiceTime_;
+    long      voiceLen_;
+
+    MpCtlAnimation::AnimDataId anim_;
+    long      animTime_;
+    bool      animBlend_;
+
+    // No copy
+    MpOfflineRender(const MpOfflineRender &src);
+    MpOfflineRender& operator=(const MpOfflineRender &src);
+};
+
+
+/**
+ * \class MpY4mWriter
+ *
+ * MpY4mWriter writes RGBA frames to a YUV4MPEG2 (4:2:0) file,
+ * which can be encoded to MP4 by external tools.
+ */
+class MpY4mWriter {
+
+  public:
+
+    /**
+     * open output file
+     *
+     * @param path : path to output file
+     * @param w    : frame width
+     * @param h    : frame height
+     * @param fps  : frames per second
+     */
+    mpResult Open(const char *path, int w, int h, int fps) {
+        if (path == NULL || w <= 0 || h <= 0 || fps <= 0) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        Close();
+        fp_ = fopen(path, "wb");
+        if (fp_ == NULL) {
+            return MP_ERROR_IO;
+        }
+        w_  = w;
+        h_  = h;
+        cw_ = (w + 1) / 2;
+        ch_ = (h + 1) / 2;
+        buf_ = new unsigned char[w_ * h_ + cw_ * ch_ * 2];
+        if (fprintf(fp_, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", w, h, fps) < 0) {
+            Close();
+            return MP_ERROR_IO;
+        }
+        return MP_SUCCESS;
+    }
+
+    /**
+     * write a frame
+     *
+     * @param rgba     : RGBA data of w*h pixels
+     * @param bottomUp : true if lower left origin (as glReadPixels)
+     */
+    mpResult WriteFrame(const unsigned char *rgba, bool bottomUp = true) {
+        if (fp_ == NULL) {
+            return MP_ERROR_INVALID_STATE;
+        }
+        if (rgba == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        unsigned char *py = buf_;
+        unsigned char *pu = buf_ + w_ * h_;
+        unsigned char *pv = pu + cw_ * ch_;
+
+        // BT.601 limited range, chroma averaged over 2x2 block
+        for (int y = 0; y < h_; y++) {
+            const unsigned char *src = RowOf(rgba, y, bottomUp);
+            for (int x = 0; x < w_; x++) {
+                int r = src[x * 4], g = src[x * 4 + 1], b = src[x * 4 + 2];
+                py[y * w_ + x] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            }
+        }
+        for (int cy = 0; cy < ch_; cy++) {
+            const unsigned char *row0 = RowOf(rgba, cy * 2, bottomUp);
+            const unsigned char *row1 = RowOf(rgba, (cy * 2 + 1 < h_) ? cy * 2 + 1 : cy * 2, bottomUp);
+            for (int cx = 0; cx < cw_; cx++) {
+                int x0 = cx * 2;
+                int x1 = (x0 + 1 < w_) ? x0 + 1 : x0;
+                int r = row0[x0 * 4]     + row0[x1 * 4]     + row1[x0 * 4]     + row1[x1 * 4];
+                int g = row0[x0 * 4 + 1] + row0[x1 * 4 + 1] + row1[x0 * 4 + 1] + row1[x1 * 4 + 1];
+                int b = row0[x0 * 4 + 2] + row0[x1 * 4 + 2] + row1[x0 * 4 + 2] + row1[x1 * 4 + 2];
+                pu[cy * cw_ + cx] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+                pv[cy * cw_ + cx] = (unsigned char)(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+            }
+        }
+
+        size_t size = (size_t)(w_ * h_ + cw_ * ch_ * 2);
+        if (fputs("FRAME\n", fp_) < 0 || fwrite(buf_, 1, size, fp_) != size) {
+            return MP_ERROR_IO;
+        }
+        return MP_SUCCESS;
+    }
+
+    /**
+     * close output file
+     */
+    mpResult Close() {
+        mpResult res = MP_SUCCESS;
+        if (fp_ != NULL && fclose(fp_) != 0) {
+            res = MP_ERROR_IO;
+        }
+        fp_ = NULL;
+        delete [] buf_;
+        buf_ = NULL;
+        return res;
+    }
+
+    /**
+     */
+    MpY4mWriter() : fp_(NULL), buf_(NULL), w_(0), h_(0), cw_(0), ch_(0) {}
+    virtual ~MpY4mWriter() { Close(); }
+
+  private:
+    const unsigned char *RowOf(const unsigned char *rgba, int y, bool bottomUp) const {
+        return rgba + (size_t)(bottomUp ? h_ - 1 - y : y) * w_ * 4;
+    }
+
+    FILE          *fp_;
+    unsigned char *buf_;
+    int w_;
+    int h_;
+    int cw_;
+    int ch_;
+
+    // No copy. to prevent buf_ from double free
+    MpY4mWriter(const MpY4mWriter &src);
+    MpY4mWriter& operator=(const MpY4mWriter &src);
+};
+
+
+} // namespace motionportrait
+
+#endif /* MPOFFLINE_H_ */
@@ -0,0 +1,135 @@
+/*
+ *
+ * Copyright 2013-2014 by MotionPortrait, Inc.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef MPPROGSYNTH_H_
+#define MPPROGSYNTH_H_
+
+// requires C++11
+#include "mptypes.h"
+#include "mpsynth.h"
+#include "mpcancel.h"
+
+namespace motionportrait {
+
+
+/**
+ * \class MpProgressiveSynth
+ *
+ * MpProgressiveSynth synthesizes a low resolution avatar first and
+ * passes it to a callback, then synthesizes the avatar with the full
+ * TEX_SIZE/MODEL_SIZE.
+ *
+ * Output format of the MpSynth should be FORMAT_BIN
+ *
+ * note:
+ * the final pass detects feature points again. they can be passed to it
+ * only by MpSynth::SetMpfp(), which cannot be cleared and would apply to
+ * every later synthesis on the MpSynth.
+ */
+class MpProgressiveSynth {
+
+  public:
+
+    /**
+     * preview callback
+     *
+     * @param preview : low resolution face object. the callback takes
+     *                  ownership and must remove it by DestroyFaceBin()
+     * @param user    : user data passed to Synth()
+     */
+    typedef void (*PreviewCallback)(mpFaceObject preview, void *user);
+
+    /**
+     * Initialize
+     *
+     * @param synth       : initialized synthesizer
+     * @param texSize     : TEX_SIZE of the final avatar
+     * @param modelSize   : MODEL_SIZE of the final avatar
+     * @param previewSize : TEX_SIZE and MODEL_SIZE of the preview.
+     *                      must be 256 or one of the sizes allowed by TEX_SIZE
+     */
+    mpResult Init(MpSynth *synth, int texSize, int modelSize, int previewSize = 256) {
+        if (synth == NULL || previewSize > texSize || previewSize > modelSize) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        synth_       = synth;
+        texSize_     = texSize;
+        modelSize_   = modelSize;
+        previewSize_ = previewSize;
+        return MP_SUCCESS;
+    }
+
+    /**
+     * synthesize an avatar progressively
+     *
+     * @param inImg   : input image
+     * @param cb      : preview callback
+     * @param user    : user data passed to cb
+     * @param pObject : [out]generated face object. This object should be removed by DestroyFaceBin() when it is no longer used.
+     * @param cancel  : checked before each pass. may be NULL
+     * @return MP_ERROR_TIMEOUT if cancelled
+     */
+    mpResult Synth(MpSynth::Img &inImg, PreviewCallback cb, void *user, mpFaceObject *pObject,
+                const MpCancelToken *cancel = NULL) {
+        if (synth_ == NULL) {
+            return MP_ERROR_INVALID_STATE;
+        }
+        if (cb == NULL || pObject == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+
+        if (cancel != NULL && cancel->IsCancelled()) {
+            return MP_ERROR_TIMEOUT;
+        }
+        mpResult res = SetSize(previewSize_, previewSize_);
+        if (res != MP_SUCCESS) {
+            return res;
+        }
+        mpFaceObject preview = NULL;
+        res = synth_->Synth(inImg, &preview);
+        if (res != MP_SUCCESS) {
+            SetSize(texSize_, modelSize_);
+            return res;
+        }
+        cb(preview, user);
+
+        res = SetSize(texSize_, modelSize_);
+        if (res != MP_SUCCESS) {
+            return res;
+        }
+        if (cancel != NULL && cancel->IsCancelled()) {
+            return MP_ERROR_TIMEOUT;
+        }
+        return synth_->Synth(inImg, pObject);
+    }
+
+    /**
+     */
+    MpProgressiveSynth()
+    : synth_(NULL), texSize_(512), modelSize_(512), previewSize_(256) {}
+    virtual ~MpProgressiveSynth() {}
+
+  private:
+    mpResult SetSize(int texSize, int modelSize) {
+        mpResult res = synth_->SetParami(MpSynth::TEX_SIZE, texSize);
+        if (res != MP_SUCCESS) {
+            return res;
+        }
+        return synth_->SetParami(MpSynth::MODEL_SIZE, modelSize);
+    }
+
+    MpSynth *synth_;
+    int      texSize_;
+    int      modelSize_;
+    int      previewSize_;
+};
+
+
+} // namespace motionportrait
+
+#endif /* MPPROGSYNTH_H_ */
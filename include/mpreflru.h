@@ -0,0 +1,175 @@
+/*
+ *
+ * Copyright 2013-2014 by MotionPortrait, Inc.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef MPREFLRU_H_
+#define MPREFLRU_H_
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "mptypes.h"
+
+namespace motionportrait {
+
+
+/**
+ * \class MpRefLru
+ *
+ * MpRefLru is the bookkeeping shared by MpAssetCache and MpFacePool.
+ * it maps a path to a value with a reference count and a size, and
+ * keeps unused values (count is 0) in LRU order.
+ * it does not create or destroy values; the owner does it.
+ *
+ * T must be comparable and unique per entry, e.g. a pointer or an id.
+ */
+template <class T>
+class MpRefLru {
+
+  public:
+
+    /**
+     * find value and add reference
+     *
+     * @param path  : key
+     * @param value : [out]value
+     * @return true if found
+     */
+    bool Acquire(const std::string &path, T &value) {
+        typename EntryMap::iterator it = entries_.find(path);
+        if (it == entries_.end()) {
+            return false;
+        }
+        Entry &e = it->second;
+        if (e.ref++ == 0) {
+            lru_.erase(e.lru);
+            unused_--;
+        }
+        value = e.value;
+        return true;
+    }
+
+    /**
+     * add new value with one reference
+     *
+     * @param path  : key. must not be in use
+     * @param value : value
+     * @param size  : size of value in byte
+     */
+    void Insert(const std::string &path, const T &value, size_t size) {
+        Entry &e = entries_[path];
+        e.value = value;
+        e.size  = size;
+        e.ref   = 1;
+        total_ += size;
+        values_[value] = path;
+    }
+
+    /**
+     * remove reference. the value becomes the most recently used unused
+     * value when the count reaches 0
+     *
+     * @param value : value
+     */
+    mpResult Release(const T &value) {
+        typename ValueMap::iterator valIt = values_.find(value);
+        if (valIt == values_.end()) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        typename EntryMap::iterator it = entries_.find(valIt->second);
+        Entry &e = it->second;
+        if (e.ref == 0) {
+            return MP_ERROR_INVALID_STATE;
+        }
+        if (--e.ref == 0) {
+            e.lru = lru_.insert(lru_.end(), it->first);
+            unused_++;
+        }
+        return MP_SUCCESS;
+    }
+
+    /**
+     * remove the least recently used unused value.
+     * the owner destroys it.
+     *
+     * @param value : [out]removed value
+     * @return false if there is no unused value
+     */
+    bool PopUnused(T &value) {
+        if (lru_.empty()) {
+            return false;
+        }
+        typename EntryMap::iterator it = entries_.find(lru_.front());
+        lru_.pop_front();
+        unused_--;
+        value   = it->second.value;
+        total_ -= it->second.size;
+        values_.erase(value);
+        entries_.erase(it);
+        return true;
+    }
+
+    /**
+     * remove all values, including values in use.
+     * the owner destroys them.
+     *
+     * @param values : [out]removed values
+     */
+    void Clear(std::vector<T> &values) {
+        for (typename EntryMap::iterator it = entries_.begin(); it != entries_.end(); ++it) {
+            values.push_back(it->second.value);
+        }
+        entries_.clear();
+        values_.clear();
+        lru_.clear();
+        total_  = 0;
+        unused_ = 0;
+    }
+
+    /**
+     * get total size of values in byte, including values in use
+     */
+    size_t GetSize() const { return total_; }
+
+    /**
+     * get number of unused values
+     */
+    size_t GetUnusedCount() const { return unused_; }
+
+    /**
+     */
+    MpRefLru() : total_(0), unused_(0) {}
+    virtual ~MpRefLru() {}
+
+  private:
+    typedef std::list<std::string> LruList;
+
+    struct Entry {
+        T      value;
+        size_t size;
+        int    ref;
+        typename LruList::iterator lru;
+    };
+    typedef std::map<std::string, Entry> EntryMap;
+    typedef std::map<T, std::string>     ValueMap;
+
+    size_t   total_;
+    size_t   unused_;
+    EntryMap entries_;
+    ValueMap values_;
+    LruList  lru_;
+
+    // No copy
+    MpRefLru(const MpRefLru &src);
+    MpRefLru& operator=(const MpRefLru &src);
+};
+
+
+} // namespace motionportrait
+
+#endif /* MPREFLRU_H_ */
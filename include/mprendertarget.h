@@ -0,0 +1,256 @@
+/*
+ *
+ * Copyright 2013-2014 by MotionPortrait, Inc.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef MPRENDERTARGET_H_
+#define MPRENDERTARGET_H_
+
+#if defined(__APPLE__)
+#include <OpenGLES/ES2/gl.h>
+#elif defined(__ANDROID__) || defined(WEBGL)
+#include <GLES2/gl2.h>
+#else
+// framebuffer functions are declared by <GL/glext.h> only if this is
+// defined before its first include, so it must be defined by the build
+#ifndef GL_GLEXT_PROTOTYPES
+#error "define GL_GLEXT_PROTOTYPES in the build to use mprendertarget.h"
+#endif
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
+#include "mptypes.h"
+#include "mprender.h"
+
+namespace motionportrait {
+
+
+/**
+ * \class MpRenderTarget
+ *
+ * MpRenderTarget draws an avatar into an offscreen framebuffer instead
+ * of the bound one, and exposes its color+alpha as a texture for
+ * compositing without copy.
+ *
+ * the framebuffer can be created by Init() with a texture owned by
+ * MpRenderTarget, or given by the caller with InitWithFramebuffer().
+ * Draw() restores the caller's framebuffer binding and GL viewport. when
+ * clearing, it also saves and restores clear color, color/depth/stencil
+ * (front and back) write masks and scissor test. depth/stencil clear values are used as set
+ * by the caller (1.0 and 0 by default). MpRender's own viewport is not
+ * restored unless it is given to Draw().
+ *
+ * note:
+ * all functions, including destructor, must be called from GL thread.
+ * MpRender should be initialized with FLAG_STENCIL_FILL only if the
+ * framebuffer has a stencil buffer. framebuffers created by Init() have none.
+ * on desktop GL, GL_GLEXT_PROTOTYPES must be defined by the build.
+ */
+class MpRenderTarget {
+
+  public:
+
+    /**
+     * create framebuffer with RGBA texture and depth buffer
+     *
+     * @param w : width
+     * @param h : height
+     */
+    mpResult Init(int w, int h) {
+        if (w <= 0 || h <= 0) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        Release();
+
+        GLint prevFbo = 0;
+        GLint prevTex = 0;
+        GLint prevRb  = 0;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &prevTex);
+        glGetIntegerv(GL_RENDERBUFFER_BINDING, &prevRb);
+
+        glGenTextures(1, &tex_);
+        glBindTexture(GL_TEXTURE_2D, tex_);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+        glGenRenderbuffers(1, &depth_);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth_);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, w, h);
+
+        glGenFramebuffers(1, &fbo_);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex_, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)prevFbo);
+        glBindTexture(GL_TEXTURE_2D, (GLuint)prevTex);
+        glBindRenderbuffer(GL_RENDERBUFFER, (GLuint)prevRb);
+
+        owned_ = true;
+        w_ = w;
+        h_ = h;
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            Release();
+            return MP_ERROR_OTHERS;
+        }
+        return MP_SUCCESS;
+    }
+
+    /**
+     * use framebuffer created by the caller. it is not deleted.
+     *
+     * @param fbo : framebuffer object
+     * @param w   : width
+     * @param h   : height
+     */
+    mpResult InitWithFramebuffer(GLuint fbo, int w, int h) {
+        if (w <= 0 || h <= 0) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        Release();
+        fbo_   = fbo;
+        owned_ = false;
+        w_ = w;
+        h_ = h;
+        return MP_SUCCESS;
+    }
+
+    /**
+     * draw avatar into the framebuffer.
+     * MpRender's viewport is set to the whole framebuffer. it is set to
+     * restoreViewport after drawing if given, otherwise the caller must
+     * call MpRender::SetViewport() again before drawing to its own target.
+     *
+     * @param render          : renderer. SetFace must be done
+     * @param clear           : if true, color(transparent), depth and stencil are cleared
+     * @param restoreViewport : MpRender's viewport to be set after drawing. may be NULL
+     */
+    mpResult Draw(MpRender &render, bool clear = true, mpRect *restoreViewport = NULL) {
+        if (w_ == 0) {
+            return MP_ERROR_INVALID_STATE;
+        }
+        GLint prevFbo = 0;
+        GLint prevViewport[4];
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
+        glGetIntegerv(GL_VIEWPORT, prevViewport);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+        glViewport(0, 0, w_, h_);
+        if (clear) {
+            Clear();
+        }
+
+        mpRect viewport = { 0, 0, w_, h_ };
+        mpResult res = render.SetViewport(viewport);
+        if (res == MP_SUCCESS) {
+            res = render.Draw();
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)prevFbo);
+        glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+        if (restoreViewport != NULL) {
+            mpResult res2 = render.SetViewport(*restoreViewport);
+            if (res == MP_SUCCESS) {
+                res = res2;
+            }
+        }
+        return res;
+    }
+
+    /**
+     * get color texture. 0 if the framebuffer is given by the caller
+     */
+    GLuint GetTexture() const { return tex_; }
+
+    /**
+     * get framebuffer object
+     */
+    GLuint GetFramebuffer() const { return fbo_; }
+
+    /**
+     * delete GL objects created by Init()
+     */
+    void Release() {
+        if (owned_) {
+            if (fbo_ != 0) {
+                glDeleteFramebuffers(1, &fbo_);
+            }
+            if (depth_ != 0) {
+                glDeleteRenderbuffers(1, &depth_);
+            }
+            if (tex_ != 0) {
+                glDeleteTextures(1, &tex_);
+            }
+        }
+        fbo_   = 0;
+        depth_ = 0;
+        tex_   = 0;
+        owned_ = false;
+        w_ = 0;
+        h_ = 0;
+    }
+
+    /**
+     */
+    MpRenderTarget() : fbo_(0), tex_(0), depth_(0), owned_(false), w_(0), h_(0) {}
+    virtual ~MpRenderTarget() { Release(); }
+
+  private:
+    // clear whole framebuffer regardless of scissor and write masks
+    void Clear() {
+        GLfloat   prevColor[4];
+        GLboolean prevColorMask[4];
+        GLboolean prevDepthMask       = GL_TRUE;
+        GLint     prevStencilMask     = 0;
+        GLint     prevStencilBackMask = 0;
+        GLboolean prevScissor         = glIsEnabled(GL_SCISSOR_TEST);
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, prevColor);
+        glGetBooleanv(GL_COLOR_WRITEMASK, prevColorMask);
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &prevDepthMask);
+        glGetIntegerv(GL_STENCIL_WRITEMASK, &prevStencilMask);
+        glGetIntegerv(GL_STENCIL_BACK_WRITEMASK, &prevStencilBackMask);
+
+        if (prevScissor) {
+            glDisable(GL_SCISSOR_TEST);
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+        glStencilMask(~0u);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+        glClearColor(prevColor[0], prevColor[1], prevColor[2], prevColor[3]);
+        glColorMask(prevColorMask[0], prevColorMask[1], prevColorMask[2], prevColorMask[3]);
+        glDepthMask(prevDepthMask);
+        glStencilMaskSeparate(GL_FRONT, (GLuint)prevStencilMask);
+        glStencilMaskSeparate(GL_BACK, (GLuint)prevStencilBackMask);
+        if (prevScissor) {
+            glEnable(GL_SCISSOR_TEST);
+        }
+    }
+
+    GLuint fbo_;
+    GLuint tex_;
+    GLuint depth_;
+    bool   owned_;
+    int    w_;
+    int    h_;
+
+    // No copy
+    MpRenderTarget(const MpRenderTarget &src);
+    MpRenderTarget& operator=(const MpRenderTarget &src);
+};
+
+
+} // namespace motionportrait
+
+#endif /* MPRENDERTARGET_H_ */
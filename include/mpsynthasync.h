@@ -0,0 +1,307 @@
+/*
+ *
+ * Copyright 2013-2014 by MotionPortrait, Inc.
+ *
+ * All rights reserved.
+ *
+ */
+
+#ifndef MPSYNTHASYNC_H_
+#define MPSYNTHASYNC_H_
+
+// requires C++11
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "mptypes.h"
+#include "mpsynth.h"
+#include "mpcancel.h"
+
+namespace motionportrait {
+
+
+/**
+ * \class MpSynthAsync
+ *
+ * MpSynthAsync runs MpSynth::Synth on worker threads.
+ * each worker owns its own MpSynth instance, so the number of workers
+ * is the number of synthesis running at once.
+ *
+ * Output format should be FORMAT_BIN
+ */
+class MpSynthAsync {
+
+  public:
+
+    /**
+     * completion callback. called on worker thread.
+     * the job no longer counts against maxInFlight when it is called.
+     * SynthAsync() called from the callback never waits for a free slot;
+     * with wait true the job is queued even beyond maxInFlight, since the
+     * workers which would free a slot may all be in callbacks.
+     * Shutdown() must not be called from the callback.
+     *
+     * @param result : result of Synth(). MP_ERROR_TIMEOUT if cancelled
+     * @param object : generated face object. NULL if failed.
+     *                 This object should be removed by DestroyFaceBin() when it is no longer used.
+     * @param user   : user data passed to SynthAsync()
+     */
+    typedef void (*Callback)(mpResult result, mpFaceObject object, void *user);
+
+    /**
+     * setup function for each worker's MpSynth, called after Init().
+     * use this to call SetParami() etc.
+     *
+     * @param synth : initialized synthesizer of a worker
+     * @param user  : user data passed to Init()
+     */
+    typedef mpResult (*SetupFunc)(MpSynth &synth, void *user);
+
+    /**
+     * result for the future returned by SynthAsync()
+     */
+    typedef struct {
+        mpResult     result;
+        mpFaceObject object;
+    } Result;
+
+    /**
+     * Initialize
+     *
+     * @param pathRes     : path to resource directory
+     * @param nWorker     : number of workers. 0 means number of cores
+     * @param maxInFlight : max number of queued and running jobs.
+     *                      0 means twice the number of workers
+     * @param setup       : setup function for each worker. may be NULL
+     * @param user        : user data passed to setup
+     */
+    mpResult Init(const char *pathRes, int nWorker = 0, int maxInFlight = 0,
+                SetupFunc setup = NULL, void *user = NULL) {
+        if (!workers_.empty()) {
+            return MP_ERROR_INVALID_STATE;
+        }
+        if (nWorker <= 0) {
+            nWorker = (int)std::thread::hardware_concurrency();
+            if (nWorker <= 0) {
+                nWorker = 1;
+            }
+        }
+        maxInFlight_ = (maxInFlight > 0) ? maxInFlight : nWorker * 2;
+
+        std::vector<std::unique_ptr<MpSynth> > synths;
+        for (int i = 0; i < nWorker; i++) {
+            std::unique_ptr<MpSynth> synth(new MpSynth());
+            mpResult res = synth->Init(pathRes);
+            if (res == MP_SUCCESS && setup != NULL) {
+                res = setup(*synth, user);
+            }
+            if (res != MP_SUCCESS) {
+                return res;
+            }
+            synths.push_back(std::move(synth));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = false;
+        for (int i = 0; i < nWorker; i++) {
+            synths_.push_back(std::move(synths[i]));
+            workers_.push_back(std::thread(&MpSynthAsync::Run, this, synths_.back().get()));
+            workerIds_.push_back(workers_.back().get_id());
+        }
+        return MP_SUCCESS;
+    }
+
+    /**
+     * synthesize an avatar asynchronously.
+     * image data must be kept until the callback is called.
+     *
+     * @param inImg  : input image
+     * @param cb     : completion callback
+     * @param user   : user data passed to cb
+     * @param cancel : checked before the job starts. may be NULL.
+     *                 must be kept until the callback is called
+     * @param wait   : if true, waits while maxInFlight jobs are in flight,
+     *                 except on worker thread (see Callback).
+     *                 if false, returns MP_ERROR_OUT_OF_MEMORY instead
+     * @return MP_SUCCESS if queued.
+     *         MP_ERROR_OUT_OF_MEMORY if wait is false and no slot is free.
+     *         MP_ERROR_INVALID_STATE if not initialized or shut down
+     */
+    mpResult SynthAsync(MpSynth::Img &inImg, Callback cb, void *user,
+                const MpCancelToken *cancel = NULL, bool wait = true) {
+        if (cb == NULL) {
+            return MP_ERROR_INVALID_PARAM;
+        }
+        Job job;
+        job.img    = inImg;
+        job.cb     = cb;
+        job.user   = user;
+        job.cancel = cancel;
+        return Push(job, wait);
+    }
+
+    /**
+     * synthesize an avatar asynchronously.
+     * image data must be kept until the future is ready.
+     * if the job is not queued, the returned future is already ready and
+     * carries the error of the callback version.
+     *
+     * @param inImg  : input image
+     * @param cancel : checked before the job starts. may be NULL
+     * @param wait   : if true, waits while maxInFlight jobs are in flight.
+     *                 if false, the future carries MP_ERROR_OUT_OF_MEMORY instead
+     */
+    std::future<Result> SynthAsync(MpSynth::Img &inImg, const MpCancelToken *cancel = NULL,
+                bool wait = true) {
+        std::promise<Result> *p = new std::promise<Result>();
+        std::future<Result> f = p->get_future();
+        mpResult res = SynthAsync(inImg, &MpSynthAsync::SetPromise, p, cancel, wait);
+        if (res != MP_SUCCESS) {
+            SetPromise(res, NULL, p);
+        }
+        return f;
+    }
+
+    /**
+     * get number of queued and running jobs
+     */
+    int GetInFlight() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return inFlight_;
+    }
+
+    /**
+     * wait for all jobs and stop workers.
+     * must not be called from the callback, or the worker joins itself.
+     */
+    void Shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        queued_.notify_all();
+        done_.notify_all();
+        for (size_t i = 0; i < workers_.size(); i++) {
+            workers_[i].join();
+        }
+        workers_.clear();
+        synths_.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        workerIds_.clear();
+    }
+
+    /**
+     */
+    MpSynthAsync() : maxInFlight_(0), inFlight_(0), stop_(true) {}
+    virtual ~MpSynthAsync() { Shutdown(); }
+
+  private:
+    struct Job {
+        MpSynth::Img         img;
+        Callback             cb;
+        void                *user;
+        const MpCancelToken *cancel;
+    };
+
+    mpResult Push(const Job &job, bool wait) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stop_) {
+            return MP_ERROR_INVALID_STATE;
+        }
+        if (inFlight_ >= maxInFlight_) {
+            if (!wait) {
+                return MP_ERROR_OUT_OF_MEMORY;
+            }
+            // no wait on worker thread. it would block the worker which
+            // must drain the queue to free a slot
+            if (!IsWorker()) {
+                done_.wait(lock, [this]() { return stop_ || inFlight_ < maxInFlight_; });
+                if (stop_) {
+                    return MP_ERROR_INVALID_STATE;
+                }
+            }
+        }
+        queue_.push_back(job);
+        inFlight_++;
+        lock.unlock();
+        queued_.notify_one();
+        return MP_SUCCESS;
+    }
+
+    void Run(MpSynth *synth) {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                queued_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+                if (queue_.empty()) {
+                    return;
+                }
+                job = queue_.front();
+                queue_.pop_front();
+            }
+
+            mpFaceObject object = NULL;
+            mpResult res = MP_ERROR_TIMEOUT;
+            if (job.cancel == NULL || !job.cancel->IsCancelled()) {
+                res = synth->Synth(job.img, &object);
+                if (res != MP_SUCCESS) {
+                    object = NULL;
+                }
+            }
+            // free the slot before the callback, so that it is counted
+            // correctly by GetInFlight() and waiting producers
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                inFlight_--;
+            }
+            done_.notify_one();
+
+            job.cb(res, object, job.user);
+        }
+    }
+
+    // mutex_ must be locked
+    bool IsWorker() const {
+        std::thread::id self = std::this_thread::get_id();
+        for (size_t i = 0; i < workerIds_.size(); i++) {
+            if (workerIds_[i] == self) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void SetPromise(mpResult result, mpFaceObject object, void *user) {
+        std::promise<Result> *p = static_cast<std::promise<Result> *>(user);
+        Result r;
+        r.result = result;
+        r.object = object;
+        p->set_value(r);
+        delete p;
+    }
+
+    std::mutex                            mutex_;
+    std::condition_variable               queued_;
+    std::condition_variable               done_;
+    std::deque<Job>                       queue_;
+    std::vector<std::unique_ptr<MpSynth> > synths_;
+    std::vector<std::thread>              workers_;
+    std::vector<std::thread::id>          workerIds_;
+    int                                   maxInFlight_;
+    int                                   inFlight_;
+    bool                                  stop_;
+
+    // No copy
+    MpSynthAsync(const MpSynthAsync &src);
+    MpSynthAsync& operator=(const MpSynthAsync &src);
+};
+
+
+} // namespace motionportrait
+
+#endif /* MPSYNTHASYNC_H_ */